@@ -1,9 +1,15 @@
 #include <ctype.h>
 #include "solution.h"
 #define NEW_HASH
+#define FILTER_BITS_PER_KEY 10
+#define FILTER_PROBES 7
 
 
-HashMap *create_hashmap(size_t key_space){
+static Entry *alloc_entry(HashMap *hm){
+    return calloc(1, hm->entry_size);
+}
+
+static HashMap *create_map(size_t key_space, size_t entry_size){
     if(key_space < 1){
         return NULL;
     }
@@ -18,9 +24,11 @@ HashMap *create_hashmap(size_t key_space){
     }
     hm->num_buckets = key_space;
     hm->size = 0;
+    hm->entry_size = entry_size;
     set_hash_function(hm, hash);
+    set_clock_function(hm, monotonic_clock);
     for(size_t i = 0; i < key_space; i++){
-        hm->entries[i] = newEntry();
+        hm->entries[i] = alloc_entry(hm);
         if (hm->entries[i] == NULL){
             free(hm);
             return NULL;
@@ -29,6 +37,24 @@ HashMap *create_hashmap(size_t key_space){
     return hm;
 }
 
+HashMap *create_hashmap(size_t key_space){
+    return create_map(key_space, sizeof(Entry));
+}
+
+HashMap *create_cache(size_t key_space, size_t capacity, CacheUnit unit, DestroyDataCallback destroy_data){
+    if(capacity < 1){
+        return NULL;
+    }
+    HashMap *hm = create_map(key_space, sizeof(TrackedEntry));
+    if (hm == NULL){
+        return NULL;
+    }
+    hm->capacity = capacity;
+    hm->capacity_unit = unit;
+    hm->evict_data = destroy_data;
+    return hm;
+}
+
 Entry *newEntry(){
     Entry *new_entry = calloc(sizeof(Entry),1);
     if (new_entry == NULL){
@@ -40,96 +66,495 @@ Entry *newEntry(){
     return new_entry;
 }
 
-void delete_hashmap(HashMap *hm, DestroyDataCallback destroy_data) {
-    if(hm == NULL){
+static bool holds_values(HashMap *hm){
+    return hm->entry_size >= sizeof(Entry);
+}
+
+static bool tracks_entries(HashMap *hm){
+    return hm->entry_size == sizeof(TrackedEntry);
+}
+
+static TrackedEntry *tracked(Entry *entry){
+    return (TrackedEntry *) entry;
+}
+
+//a HashSet entry has no value and always reads as NULL
+static void *entry_value(HashMap *hm, Entry *entry){
+    return holds_values(hm) ? entry->value : NULL;
+}
+
+static void set_entry_value(HashMap *hm, Entry *entry, void *value){
+    if(holds_values(hm)){
+        entry->value = value;
+    }
+}
+
+static bool in_block(void *ptr, void *block, size_t bytes){
+    uintptr_t address = (uintptr_t) ptr;
+    uintptr_t start = (uintptr_t) block;
+    return block != NULL && address >= start && address < start + bytes;
+}
+
+//entries and keys laid out by hashmap_build live in one block and are freed with the map
+static void free_key(HashMap *hm, char *key){
+    if(!in_block(key, hm->key_arena, hm->key_arena_size)){
+        free(key);
+    }
+}
+
+static void free_entry(HashMap *hm, Entry *entry){
+    if(!in_block(entry, hm->entry_arena, sizeof(Entry) * hm->entry_arena_size)){
+        free(entry);
+    }
+}
+
+//splits [0, n) in nthreads ranges and runs work on each, the last one on the calling thread
+typedef void (*RangeWork)(void *ctx, size_t begin, size_t end);
+
+typedef struct RangeTask {
+    RangeWork work;
+    void *ctx;
+    size_t begin;
+    size_t end;
+} RangeTask;
+
+static void *run_range_task(void *arg){
+    RangeTask *task = arg;
+    task->work(task->ctx, task->begin, task->end);
+    return NULL;
+}
+
+static void run_ranges(size_t n, size_t nthreads, RangeWork work, void *ctx){
+    if(nthreads > n){
+        nthreads = n;
+    }
+    if(nthreads <= 1){
+        work(ctx, 0, n);
         return;
     }
-    for (size_t i = 0; i < hm->num_buckets; i++) {
+    RangeTask *tasks = calloc(nthreads, sizeof(RangeTask));
+    pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+    bool *started = calloc(nthreads, sizeof(bool));
+    if(tasks == NULL || threads == NULL || started == NULL){
+        free(tasks);
+        free(threads);
+        free(started);
+        work(ctx, 0, n);
+        return;
+    }
+    for(size_t t = 0; t < nthreads; t++){
+        tasks[t].work = work;
+        tasks[t].ctx = ctx;
+        tasks[t].begin = n / nthreads * t;
+        tasks[t].end = t + 1 == nthreads ? n : n / nthreads * (t + 1);
+    }
+    for(size_t t = 0; t + 1 < nthreads; t++){
+        started[t] = pthread_create(&threads[t], NULL, run_range_task, &tasks[t]) == 0;
+        if(!started[t]){
+            //no thread for this range, run it here instead
+            run_range_task(&tasks[t]);
+        }
+    }
+    run_range_task(&tasks[nthreads - 1]);
+    for(size_t t = 0; t + 1 < nthreads; t++){
+        if(started[t]){
+            pthread_join(threads[t], NULL);
+        }
+    }
+    free(tasks);
+    free(threads);
+    free(started);
+}
+
+typedef struct BuildContext {
+    HashMap *hm;
+    char **keys;
+    void **values;
+    unsigned int *buckets;      // bucket of every key
+    size_t *lengths;            // strlen of every key
+    size_t *slots;              // entry_arena slot of every key
+    size_t *key_offsets;        // key_arena offset of every entry_arena slot
+    size_t *bucket_start;       // first entry_arena slot of every bucket
+    atomic_bool duplicate;      // set when two keys are equal
+} BuildContext;
+
+static void build_hash_keys(void *ctx, size_t begin, size_t end){
+    BuildContext *build = ctx;
+    for(size_t i = begin; i < end; i++){
+        build->buckets[i] = build->hm->hash(build->keys[i]) % build->hm->num_buckets;
+        build->lengths[i] = strlen(build->keys[i]);
+    }
+}
+
+static void build_fill_entries(void *ctx, size_t begin, size_t end){
+    BuildContext *build = ctx;
+    for(size_t i = begin; i < end; i++){
+        Entry *entry = &build->hm->entry_arena[build->slots[i]];
+        entry->key = build->hm->key_arena + build->key_offsets[build->slots[i]];
+        memcpy(entry->key, build->keys[i], build->lengths[i] + 1);
+        entry->value = build->values == NULL ? NULL : build->values[i];
+    }
+}
+
+static void build_check_duplicates(void *ctx, size_t begin, size_t end){
+    BuildContext *build = ctx;
+    for(size_t i = begin; i < end && !atomic_load(&build->duplicate); i++){
+        for(Entry *entry = build->hm->entries[i]; entry != NULL && entry->key != NULL; entry = entry->next){
+            for(Entry *other = entry->next; other != NULL; other = other->next){
+                if(strcmp(entry->key, other->key) == 0){
+                    atomic_store(&build->duplicate, true);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static void free_build(BuildContext *build){
+    free(build->buckets);
+    free(build->lengths);
+    free(build->slots);
+    free(build->key_offsets);
+    free(build->bucket_start);
+}
+
+static HashMap *abort_build(BuildContext *build){
+    if(build->hm != NULL){
+        free(build->hm->entries);
+        free(build->hm->entry_arena);
+        free(build->hm->key_arena);
+        free(build->hm);
+    }
+    free_build(build);
+    return NULL;
+}
+
+//builds a map with one bucket per key hashed by hash_function (fnvHash if NULL), NULL if two keys are equal
+HashMap *hashmap_build(char **keys, void **values, size_t n, unsigned int (*hash_function)(char *key), size_t nthreads){
+    if(keys == NULL || n < 1){
+        return NULL;
+    }
+    BuildContext build = {
+        .hm = calloc(1,sizeof(HashMap)),
+        .keys = keys,
+        .values = values,
+        .buckets = malloc(sizeof(unsigned int) * n),
+        .lengths = malloc(sizeof(size_t) * n),
+        .slots = malloc(sizeof(size_t) * n),
+        .key_offsets = NULL,
+        .bucket_start = calloc(n + 1, sizeof(size_t)),
+        .duplicate = false,
+    };
+    HashMap *hm = build.hm;
+    if(hm == NULL || build.buckets == NULL || build.lengths == NULL || build.slots == NULL || build.bucket_start == NULL){
+        return abort_build(&build);
+    }
+    hm->entries = calloc(n, sizeof(Entry*));
+    if(hm->entries == NULL){
+        return abort_build(&build);
+    }
+    hm->num_buckets = n;
+    hm->entry_size = sizeof(Entry);
+    //the additive hash piles keys into few buckets, which defeats sizing one bucket per key
+    set_hash_function(hm, hash_function == NULL ? fnvHash : hash_function);
+    set_clock_function(hm, monotonic_clock);
+
+    run_ranges(n, nthreads, build_hash_keys, &build);
+
+    //counting sort on bucket, every bucket gets at least its empty head slot
+    size_t *bucket_start = build.bucket_start;
+    for(size_t i = 0; i < n; i++){
+        bucket_start[build.buckets[i] + 1]++;
+    }
+    for(size_t b = 0; b < n; b++){
+        if(bucket_start[b + 1] == 0){
+            bucket_start[b + 1] = 1;
+        }
+        bucket_start[b + 1] += bucket_start[b];
+    }
+    hm->entry_arena_size = bucket_start[n];
+    hm->entry_arena = calloc(hm->entry_arena_size, sizeof(Entry));
+    build.key_offsets = calloc(hm->entry_arena_size + 1, sizeof(size_t));
+    if(hm->entry_arena == NULL || build.key_offsets == NULL){
+        return abort_build(&build);
+    }
+    for(size_t b = 0; b < n; b++){
+        hm->entries[b] = &hm->entry_arena[bucket_start[b]];
+        for(size_t slot = bucket_start[b]; slot + 1 < bucket_start[b + 1]; slot++){
+            hm->entry_arena[slot].next = &hm->entry_arena[slot + 1];
+        }
+    }
+    //bucket_start becomes the next free slot of each bucket
+    for(size_t i = 0; i < n; i++){
+        build.slots[i] = bucket_start[build.buckets[i]]++;
+        build.key_offsets[build.slots[i] + 1] = build.lengths[i] + 1;
+    }
+    for(size_t slot = 0; slot < hm->entry_arena_size; slot++){
+        build.key_offsets[slot + 1] += build.key_offsets[slot];
+    }
+    hm->key_arena_size = build.key_offsets[hm->entry_arena_size];
+    hm->key_arena = malloc(hm->key_arena_size);
+    if(hm->key_arena == NULL){
+        return abort_build(&build);
+    }
+
+    run_ranges(n, nthreads, build_fill_entries, &build);
+    run_ranges(n, nthreads, build_check_duplicates, &build);
+    if(atomic_load(&build.duplicate)){
+        return abort_build(&build);
+    }
+
+    hm->size = n;
+    free_build(&build);
+    return hm;
+}
+
+typedef struct BucketContext {
+    HashMap *hm;
+    DestroyDataCallback destroy_data;
+    ParallelCallback callback;
+    void *ctx;
+    time_t now;             // walk_clock reading, entries expired by then are skipped
+} BucketContext;
+
+static void delete_buckets(void *ctx, size_t begin, size_t end){
+    BucketContext *buckets = ctx;
+    HashMap *hm = buckets->hm;
+    DestroyDataCallback destroy_data = buckets->destroy_data;
+    for (size_t i = begin; i < end; i++) {
         Entry *entry = hm->entries[i];
         if (entry->key != NULL) {
             while(entry != NULL){
                 Entry *next_entry = entry->next;
                 if(destroy_data != NULL){
-                    destroy_data(entry->value);
+                    destroy_data(entry_value(hm, entry));
                 }
-                free(entry->key);
-                free(entry);
+                free_key(hm, entry->key);
+                free_entry(hm, entry);
                 entry = next_entry;
             }
 
         }
-        free(entry);
+        free_entry(hm, entry);
     }
+}
+
+void delete_hashmap(HashMap *hm, DestroyDataCallback destroy_data) {
+    delete_hashmap_parallel(hm, destroy_data, 1);
+}
+
+//destroy_data must be safe to call from several threads at once
+void delete_hashmap_parallel(HashMap *hm, DestroyDataCallback destroy_data, size_t nthreads) {
+    if(hm == NULL){
+        return;
+    }
+    BucketContext buckets = { .hm = hm, .destroy_data = destroy_data };
+    run_ranges(hm->num_buckets, nthreads, delete_buckets, &buckets);
     free(hm->entries);
+    free(hm->expiry_heap);
+    free(hm->entry_arena);
+    free(hm->key_arena);
+    free(hm->filter);
     free(hm);
 }
 
-void insert_data(HashMap *hm, char *key, void *data, ResolveCollisionCallback resolve_collision ) {
-    if(hm == NULL || key == NULL || resolve_collision == NULL){
-        return;
+static size_t entry_cost(HashMap *hm, Entry *entry){
+    if(hm->capacity_unit == CACHE_BYTES){
+        return sizeof(TrackedEntry) + strlen(entry->key) + 1;
     }
-    Entry *entry = hm->entries[hm->hash(key) % hm->num_buckets];
+    return 1;
+}
 
-    char* key_copy = calloc(sizeof(char), (strlen(key) + 1));
-    if(key_copy == NULL){
+static bool lru_linked(HashMap *hm, TrackedEntry *entry){
+    return entry->lru_prev != NULL || entry->lru_next != NULL || hm->lru_head == entry;
+}
+
+static void lru_unlink(HashMap *hm, TrackedEntry *entry){
+    if(!lru_linked(hm, entry)){
         return;
     }
-    strcpy(key_copy, key);
+    if(entry->lru_prev != NULL){
+        entry->lru_prev->lru_next = entry->lru_next;
+    }else{
+        hm->lru_head = entry->lru_next;
+    }
+    if(entry->lru_next != NULL){
+        entry->lru_next->lru_prev = entry->lru_prev;
+    }else{
+        hm->lru_tail = entry->lru_prev;
+    }
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
 
-    if(entry->key == NULL){
-        //check if the list is empty
-        entry->key = key_copy;
-        entry->value = data;
-        hm->size++;
+//move entry to the most recently used end of the list
+static void lru_touch(HashMap *hm, TrackedEntry *entry){
+    if(entry == NULL || hm->lru_head == entry){
         return;
     }
-    //check if key already exists in the list
-    while(entry->next != NULL ){
-        if(strcmp(entry->key,key) == 0) {
-            entry->value = resolve_collision(entry->value, data);
-            free(key_copy);
+    lru_unlink(hm, entry);
+    entry->lru_next = hm->lru_head;
+    if(hm->lru_head != NULL){
+        hm->lru_head->lru_prev = entry;
+    }
+    hm->lru_head = entry;
+    if(hm->lru_tail == NULL){
+        hm->lru_tail = entry;
+    }
+}
+
+static void expiry_swap(HashMap *hm, size_t i, size_t j){
+    TrackedEntry *tmp = hm->expiry_heap[i];
+    hm->expiry_heap[i] = hm->expiry_heap[j];
+    hm->expiry_heap[j] = tmp;
+    hm->expiry_heap[i]->heap_index = i + 1;
+    hm->expiry_heap[j]->heap_index = j + 1;
+}
+
+static void expiry_sift_up(HashMap *hm, size_t i){
+    while(i > 0){
+        size_t parent = (i - 1) / 2;
+        if(hm->expiry_heap[parent]->expires_at <= hm->expiry_heap[i]->expires_at){
             return;
         }
-        entry = entry->next;
+        expiry_swap(hm, i, parent);
+        i = parent;
     }
-    //create new entry
-    Entry *new_entry = newEntry();
-    if(new_entry == NULL){
-        free(key_copy);
-        return;
+}
+
+static void expiry_sift_down(HashMap *hm, size_t i){
+    while(true){
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if(left < hm->expiry_count && hm->expiry_heap[left]->expires_at < hm->expiry_heap[smallest]->expires_at){
+            smallest = left;
+        }
+        if(right < hm->expiry_count && hm->expiry_heap[right]->expires_at < hm->expiry_heap[smallest]->expires_at){
+            smallest = right;
+        }
+        if(smallest == i){
+            return;
+        }
+        expiry_swap(hm, i, smallest);
+        i = smallest;
     }
-    new_entry->key = key_copy;
-    new_entry->value = data;
-    entry->next = new_entry;
-    hm->size++;
 }
 
-void remove_data(HashMap *hm, char *key, DestroyDataCallback destroy_data) {
-    if(hm == NULL || key == NULL){
+static void expiry_cancel(HashMap *hm, TrackedEntry *entry){
+    if(entry->heap_index == 0){
         return;
     }
-    unsigned int hash_key = hm->hash(key) % hm->num_buckets;
-    Entry *entry = hm->entries[hash_key];
-
-    if (entry->key == NULL) {
+    size_t i = entry->heap_index - 1;
+    entry->heap_index = 0;
+    hm->expiry_count--;
+    if(i == hm->expiry_count){
         return;
     }
+    hm->expiry_heap[i] = hm->expiry_heap[hm->expiry_count];
+    hm->expiry_heap[i]->heap_index = i + 1;
+    expiry_sift_up(hm, i);
+    expiry_sift_down(hm, i);
+}
 
-    Entry *prev_entry = NULL;
-    while (entry->next != NULL && strcmp(entry->key, key) != 0) {
-        prev_entry = entry;
-        entry = entry->next;
+//(re)schedules entry to expire at expires_at, returns false if the heap could not grow
+static bool expiry_schedule(HashMap *hm, TrackedEntry *entry, time_t expires_at){
+    entry->expires_at = expires_at;
+    if(entry->heap_index != 0){
+        expiry_sift_up(hm, entry->heap_index - 1);
+        expiry_sift_down(hm, entry->heap_index - 1);
+        return true;
+    }
+    if(hm->expiry_count == hm->expiry_capacity){
+        size_t new_capacity = hm->expiry_capacity == 0 ? 16 : hm->expiry_capacity * 2;
+        TrackedEntry **new_heap = realloc(hm->expiry_heap, sizeof(TrackedEntry*) * new_capacity);
+        if(new_heap == NULL){
+            return false;
+        }
+        hm->expiry_heap = new_heap;
+        hm->expiry_capacity = new_capacity;
+    }
+    hm->expiry_heap[hm->expiry_count] = entry;
+    entry->heap_index = ++hm->expiry_count;
+    expiry_sift_up(hm, hm->expiry_count - 1);
+    return true;
+}
+
+static bool expired_at(HashMap *hm, Entry *entry, time_t now){
+    if(!tracks_entries(hm)){
+        return false;
+    }
+    return tracked(entry)->heap_index != 0 && tracked(entry)->expires_at <= now;
+}
+
+static bool expired(HashMap *hm, Entry *entry){
+    if(!tracks_entries(hm) || tracked(entry)->heap_index == 0){
+        return false;
+    }
+    return expired_at(hm, entry, hm->clock());
+}
+
+//clock reading shared by a whole walk, only taken if some entry can expire
+static time_t walk_clock(HashMap *hm){
+    return hm->expiry_count > 0 ? hm->clock() : 0;
+}
+
+//FNV-1a, independent of hm->hash so the filter survives set_hash_function
+static uint64_t filter_hash(char *key){
+    uint64_t hash = 14695981039346656037ULL;
+    while (*key != '\0') {
+        hash ^= (unsigned char) *key;
+        hash *= 1099511628211ULL;
+        key++;
+    }
+    return hash;
+}
+
+//probe i of key is bit (h1 + i * h2) % filter_bits
+static void filter_add(HashMap *hm, char *key){
+    uint64_t h1 = filter_hash(key);
+    uint64_t h2 = ((h1 >> 32) * 0x9E3779B97F4A7C15ULL) | 1;
+    for(size_t i = 0; i < FILTER_PROBES; i++){
+        size_t bit = (h1 + i * h2) % hm->filter_bits;
+        hm->filter[bit / 64] |= (uint64_t) 1 << (bit % 64);
+    }
+}
+
+//false means key was never inserted, true means it may have been
+static bool filter_may_contain(HashMap *hm, char *key){
+    if(hm->filter == NULL){
+        return true;
+    }
+    uint64_t h1 = filter_hash(key);
+    uint64_t h2 = ((h1 >> 32) * 0x9E3779B97F4A7C15ULL) | 1;
+    for(size_t i = 0; i < FILTER_PROBES; i++){
+        size_t bit = (h1 + i * h2) % hm->filter_bits;
+        if((hm->filter[bit / 64] & ((uint64_t) 1 << (bit % 64))) == 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+//removes entry from bucket hash_key, prev_entry is its predecessor in the chain or NULL
+static void unlink_entry(HashMap *hm, unsigned int hash_key, Entry *prev_entry, Entry *entry, DestroyDataCallback destroy_data){
+    if(tracks_entries(hm)){
+        //only entries admitted by cache_admit are linked and counted in used
+        if(hm->capacity > 0 && lru_linked(hm, tracked(entry))){
+            hm->used -= entry_cost(hm, entry);
+        }
+        lru_unlink(hm, tracked(entry));
+        expiry_cancel(hm, tracked(entry));
     }
-    //Found correct entry
     if (prev_entry == NULL) {
         if(entry->next == NULL){
             //Only element in list
-            free(entry->key);
+            free_key(hm, entry->key);
             entry->key = NULL;
             if (destroy_data != NULL) {
-                destroy_data(entry->value);
+                destroy_data(entry_value(hm, entry));
             }else{
-                entry->value = NULL;
+                set_entry_value(hm, entry, NULL);
             }
             hm->size--;
             return;
@@ -144,50 +569,473 @@ void remove_data(HashMap *hm, char *key, DestroyDataCallback destroy_data) {
     }
 
     if (destroy_data != NULL) {
-        destroy_data(entry->value);
+        destroy_data(entry_value(hm, entry));
     }
-    free(entry->key);
-    free(entry);
+    free_key(hm, entry->key);
+    free_entry(hm, entry);
     hm->size--;
 }
 
-void *get_data(HashMap *hm, char *key){
-    if(hm == NULL || key == NULL){
-        return NULL;
-    }
+typedef enum InsertResult {
+    INSERT_CREATED,         // key was absent and got a new entry
+    INSERT_REPLACED,        // resolve_collision stored a different value
+    INSERT_KEPT             // resolve_collision kept the stored value
+} InsertResult;
+
+//returns the entry now holding key, or NULL if allocation failed
+static Entry *insert_entry(HashMap *hm, char *key, void *data, ResolveCollisionCallback resolve_collision, InsertResult *result){
     unsigned int hash_key = hm->hash(key) % hm->num_buckets;
     Entry *entry = hm->entries[hash_key];
+    Entry *prev_entry = NULL;
+    *result = INSERT_KEPT;
+
+    //check if key already exists in the list, entry ends on the last element
+    while(entry->key != NULL){
+        if(strcmp(entry->key,key) == 0) {
+            if(!expired(hm, entry)){
+                void *old_value = entry_value(hm, entry);
+                void *new_value = resolve_collision(old_value, data);
+                set_entry_value(hm, entry, new_value);
+                *result = new_value == old_value ? INSERT_KEPT : INSERT_REPLACED;
+                return entry;
+            }
+            //reclaim the expired entry and insert key as if it was absent
+            unlink_entry(hm, hash_key, prev_entry, entry, hm->evict_data);
+            entry = hm->entries[hash_key];
+            while(entry->next != NULL){
+                entry = entry->next;
+            }
+            break;
+        }
+        if(entry->next == NULL){
+            break;
+        }
+        prev_entry = entry;
+        entry = entry->next;
+    }
+
+    char* key_copy = calloc(sizeof(char), (strlen(key) + 1));
+    if(key_copy == NULL){
+        return NULL;
+    }
+    strcpy(key_copy, key);
+
     if(entry->key == NULL){
+        //check if the list is empty
+        entry->key = key_copy;
+        set_entry_value(hm, entry, data);
+        hm->size++;
+        *result = INSERT_CREATED;
+        if(hm->filter != NULL){
+            filter_add(hm, key);
+        }
+        return entry;
+    }
+    //create new entry
+    Entry *new_entry = alloc_entry(hm);
+    if(new_entry == NULL){
+        free(key_copy);
         return NULL;
     }
+    new_entry->key = key_copy;
+    set_entry_value(hm, new_entry, data);
+    entry->next = new_entry;
+    hm->size++;
+    *result = INSERT_CREATED;
+    if(hm->filter != NULL){
+        filter_add(hm, key);
+    }
+    return new_entry;
+}
 
-    while(entry->key != NULL){
-        if(strcmp(entry->key,key) == 0){
-            return entry->value;
+//removes victim without knowing its predecessor, costs a walk of its chain
+static void remove_entry(HashMap *hm, Entry *victim, DestroyDataCallback destroy_data){
+    unsigned int hash_key = hm->hash(victim->key) % hm->num_buckets;
+    Entry *prev_entry = NULL;
+    Entry *entry = hm->entries[hash_key];
+    while(entry != victim){
+        prev_entry = entry;
+        entry = entry->next;
+    }
+    unlink_entry(hm, hash_key, prev_entry, victim, destroy_data);
+}
+
+//evict least recently used entries until the cache fits its capacity
+static void evict_entries(HashMap *hm){
+    while(hm->used > hm->capacity && hm->lru_tail != NULL){
+        remove_entry(hm, &hm->lru_tail->entry, hm->evict_data);
+    }
+}
+
+//cache bookkeeping for an entry that insert_entry just wrote
+static void cache_admit(HashMap *hm, Entry *entry, InsertResult result){
+    if(hm->capacity == 0){
+        return;
+    }
+    if(result == INSERT_CREATED){
+        hm->used += entry_cost(hm, entry);
+    }
+    lru_touch(hm, tracked(entry));
+    evict_entries(hm);
+}
+
+//inserts entry of hm into new_hm, which has the same or a larger entry layout
+static Entry *copy_entry(HashMap *new_hm, HashMap *hm, Entry *entry){
+    InsertResult result;
+    Entry *new_entry = insert_entry(new_hm, entry->key, entry_value(hm, entry), overWriteCallback, &result);
+    if(new_entry != NULL && tracks_entries(hm) && tracked(entry)->heap_index != 0){
+        expiry_schedule(new_hm, tracked(new_entry), tracked(entry)->expires_at);
+    }
+    return new_entry;
+}
+
+//moves every entry into fresh entries of entry_size placed by hm->hash, false if allocation failed
+static bool rebuild_map(HashMap *hm, size_t entry_size){
+    HashMap *new_hm = create_map(hm->num_buckets, entry_size);
+    if(new_hm == NULL){
+        return false;
+    }
+    new_hm->hash = hm->hash;
+    if(hm->capacity > 0){
+        //rebuild from least to most recently used so the recency order survives
+        for(TrackedEntry *entry = hm->lru_tail; entry != NULL; entry = entry->lru_prev){
+            Entry *new_entry = copy_entry(new_hm, hm, &entry->entry);
+            if(new_entry != NULL){
+                lru_touch(new_hm, tracked(new_entry));
+            }
+        }
+        hm->lru_head = new_hm->lru_head;
+        hm->lru_tail = new_hm->lru_tail;
+    }else{
+        for(size_t i = 0; i < hm->num_buckets; i++){
+            Entry *entry = hm->entries[i];
+            if(entry->key != NULL){
+                while(entry != NULL){
+                    copy_entry(new_hm, hm, entry);
+                    entry = entry->next;
+                }
+            }
         }
+    }
+    Entry** old_entries = hm->entries;
+    hm->entries = new_hm->entries;
+    new_hm->entries = old_entries;
+    new_hm->entry_size = hm->entry_size;
+    hm->entry_size = entry_size;
+    TrackedEntry** old_heap = hm->expiry_heap;
+    hm->expiry_heap = new_hm->expiry_heap;
+    new_hm->expiry_heap = old_heap;
+    size_t old_count = hm->expiry_count;
+    hm->expiry_count = new_hm->expiry_count;
+    new_hm->expiry_count = old_count;
+    size_t old_capacity = hm->expiry_capacity;
+    hm->expiry_capacity = new_hm->expiry_capacity;
+    new_hm->expiry_capacity = old_capacity;
+    //the old entries may live in a build arena, hand it over so it is freed with them
+    new_hm->entry_arena = hm->entry_arena;
+    new_hm->entry_arena_size = hm->entry_arena_size;
+    new_hm->key_arena = hm->key_arena;
+    new_hm->key_arena_size = hm->key_arena_size;
+    hm->entry_arena = NULL;
+    hm->entry_arena_size = 0;
+    hm->key_arena = NULL;
+    hm->key_arena_size = 0;
+    delete_hashmap(new_hm, NULL);
+    return true;
+}
+
+void insert_data(HashMap *hm, char *key, void *data, ResolveCollisionCallback resolve_collision ) {
+    if(hm == NULL || key == NULL || resolve_collision == NULL){
+        return;
+    }
+    InsertResult result;
+    Entry *entry = insert_entry(hm, key, data, resolve_collision, &result);
+    if(entry == NULL){
+        return;
+    }
+    //a new value from a plain insert has no ttl, a kept value keeps its deadline
+    if(result == INSERT_REPLACED && tracks_entries(hm)){
+        expiry_cancel(hm, tracked(entry));
+    }
+    cache_admit(hm, entry, result);
+}
+
+void insert_data_ttl(HashMap *hm, char *key, void *data, time_t ttl, ResolveCollisionCallback resolve_collision) {
+    if(hm == NULL || key == NULL || resolve_collision == NULL){
+        return;
+    }
+    if(!holds_values(hm)){
+        //growing a set's KeyEntry to a TrackedEntry would undo its saving
+        return;
+    }
+    //a map gets tracked entries on its first ttl
+    if(!tracks_entries(hm) && !rebuild_map(hm, sizeof(TrackedEntry))){
+        return;
+    }
+    InsertResult result;
+    Entry *entry = insert_entry(hm, key, data, resolve_collision, &result);
+    if(entry == NULL){
+        return;
+    }
+    if(!expiry_schedule(hm, tracked(entry), hm->clock() + ttl) && result == INSERT_CREATED){
+        //without a heap slot the entry could never be reclaimed, so don't keep it
+        remove_entry(hm, entry, NULL);
+        return;
+    }
+    cache_admit(hm, entry, result);
+}
+
+size_t hashmap_expire_step(HashMap *hm, size_t budget){
+    if(hm == NULL || hm->expiry_count == 0){
+        return 0;
+    }
+    time_t now = hm->clock();
+    size_t reclaimed = 0;
+    while(reclaimed < budget && hm->expiry_count > 0 && hm->expiry_heap[0]->expires_at <= now){
+        remove_entry(hm, &hm->expiry_heap[0]->entry, hm->evict_data);
+        reclaimed++;
+    }
+    return reclaimed;
+}
+
+void set_evict_callback(HashMap *hm, DestroyDataCallback destroy_data){
+    if(hm == NULL){
+        return;
+    }
+    hm->evict_data = destroy_data;
+}
+
+void remove_data(HashMap *hm, char *key, DestroyDataCallback destroy_data) {
+    if(hm == NULL || key == NULL){
+        return;
+    }
+    unsigned int hash_key = hm->hash(key) % hm->num_buckets;
+    Entry *entry = hm->entries[hash_key];
+
+    if (entry->key == NULL) {
+        return;
+    }
+
+    Entry *prev_entry = NULL;
+    while (entry->next != NULL && strcmp(entry->key, key) != 0) {
+        prev_entry = entry;
         entry = entry->next;
-        if (entry == NULL) {
-            return NULL;
+    }
+    if (strcmp(entry->key, key) != 0) {
+        //Key not in list
+        return;
+    }
+    //Found correct entry
+    unlink_entry(hm, hash_key, prev_entry, entry, destroy_data);
+}
+
+//finds key without changing the map, prev_entry is set to its predecessor in the chain
+static Entry *find_entry(HashMap *hm, char *key, unsigned int *hash_key, Entry **prev_entry){
+    if(!filter_may_contain(hm, key)){
+        return NULL;
+    }
+    *hash_key = hm->hash(key) % hm->num_buckets;
+    Entry *entry = hm->entries[*hash_key];
+    *prev_entry = NULL;
+    while(entry != NULL && entry->key != NULL){
+        if(strcmp(entry->key,key) == 0){
+            return entry;
         }
+        *prev_entry = entry;
+        entry = entry->next;
     }
     return NULL;
 }
 
+//get_data without the value, NULL if key is absent or expired
+static Entry *lookup_entry(HashMap *hm, char *key){
+    unsigned int hash_key;
+    Entry *prev_entry;
+    Entry *entry = find_entry(hm, key, &hash_key, &prev_entry);
+    if(entry != NULL && expired(hm, entry)){
+        unlink_entry(hm, hash_key, prev_entry, entry, hm->evict_data);
+        entry = NULL;
+    }
+    if(hm->capacity == 0){
+        return entry;
+    }
+    //only caches count lookups and keep recency
+    if(entry == NULL){
+        hm->misses++;
+        return NULL;
+    }
+    hm->hits++;
+    lru_touch(hm, tracked(entry));
+    return entry;
+}
+
+void *get_data(HashMap *hm, char *key){
+    if(hm == NULL || key == NULL){
+        return NULL;
+    }
+    Entry *entry = lookup_entry(hm, key);
+    if(entry == NULL){
+        return NULL;
+    }
+    return entry_value(hm, entry);
+}
+
+void *get_data_readonly(HashMap *hm, char *key){
+    if(hm == NULL || key == NULL){
+        return NULL;
+    }
+    unsigned int hash_key;
+    Entry *prev_entry;
+    Entry *entry = find_entry(hm, key, &hash_key, &prev_entry);
+    if(entry == NULL || expired(hm, entry)){
+        return NULL;
+    }
+    return entry_value(hm, entry);
+}
+
 void iterate(HashMap *hm, void (*callback)(char *key, void *data)){
     if(hm == NULL){
         return;
     }
+    time_t now = walk_clock(hm);
+    for(size_t i = 0; i < hm->num_buckets; i++){
+        Entry *entry = hm->entries[i];
+        if(entry->key != NULL){
+            while(entry != NULL){
+                if(!expired_at(hm, entry, now)){
+                    callback(entry->key,entry_value(hm, entry));
+                }
+                entry = entry->next;
+            }
+        }
+    }
+}
+
+void hashmap_enable_filter(HashMap *hm, size_t expected_keys){
+    if(hm == NULL || hm->filter != NULL){
+        return;
+    }
+    size_t words = (expected_keys * FILTER_BITS_PER_KEY + 63) / 64;
+    if(words < 1){
+        words = 1;
+    }
+    hm->filter = calloc(words, sizeof(uint64_t));
+    if(hm->filter == NULL){
+        return;
+    }
+    hm->filter_bits = words * 64;
     for(size_t i = 0; i < hm->num_buckets; i++){
         Entry *entry = hm->entries[i];
         if(entry->key != NULL){
             while(entry != NULL){
-                callback(entry->key,entry->value);
+                filter_add(hm, entry->key);
                 entry = entry->next;
             }
         }
     }
 }
 
+HashSet *create_hashset(size_t key_space){
+    HashSet *hs = calloc(1,sizeof(HashSet));
+    if (hs == NULL){
+        return NULL;
+    }
+    hs->map = create_map(key_space, sizeof(KeyEntry));
+    if (hs->map == NULL){
+        free(hs);
+        return NULL;
+    }
+    return hs;
+}
+
+void delete_hashset(HashSet *hs){
+    if(hs == NULL){
+        return;
+    }
+    delete_hashmap(hs->map, NULL);
+    free(hs);
+}
+
+void hashset_add(HashSet *hs, char *key){
+    if(hs == NULL){
+        return;
+    }
+    insert_data(hs->map, key, NULL, dontOverWriteCallback);
+}
+
+bool hashset_contains(HashSet *hs, char *key){
+    if(hs == NULL || key == NULL){
+        return false;
+    }
+    unsigned int hash_key;
+    Entry *prev_entry;
+    return find_entry(hs->map, key, &hash_key, &prev_entry) != NULL;
+}
+
+void hashset_remove(HashSet *hs, char *key){
+    if(hs == NULL){
+        return;
+    }
+    remove_data(hs->map, key, NULL);
+}
+
+void hashset_enable_filter(HashSet *hs, size_t expected_keys){
+    if(hs == NULL){
+        return;
+    }
+    hashmap_enable_filter(hs->map, expected_keys);
+}
+
+static void iterate_buckets(void *ctx, size_t begin, size_t end){
+    BucketContext *buckets = ctx;
+    for(size_t i = begin; i < end; i++){
+        Entry *entry = buckets->hm->entries[i];
+        if(entry->key != NULL){
+            while(entry != NULL){
+                if(!expired_at(buckets->hm, entry, buckets->now)){
+                    buckets->callback(entry->key, entry_value(buckets->hm, entry), buckets->ctx);
+                }
+                entry = entry->next;
+            }
+        }
+    }
+}
+
+void hashmap_parallel_for(HashMap *hm, size_t nthreads, ParallelCallback callback, void *ctx){
+    if(hm == NULL || callback == NULL){
+        return;
+    }
+    BucketContext buckets = { .hm = hm, .callback = callback, .ctx = ctx, .now = walk_clock(hm) };
+    run_ranges(hm->num_buckets, nthreads, iterate_buckets, &buckets);
+}
+
+//removes every entry predicate holds for in a single walk, returns how many were removed
+size_t hashmap_remove_if(HashMap *hm, RemovePredicate predicate, void *ctx, DestroyDataCallback destroy_data){
+    if(hm == NULL || predicate == NULL){
+        return 0;
+    }
+    size_t removed = 0;
+    time_t now = walk_clock(hm);
+    for(size_t i = 0; i < hm->num_buckets; i++){
+        Entry *prev_entry = NULL;
+        Entry *entry = hm->entries[i];
+        while(entry != NULL && entry->key != NULL){
+            Entry *next_entry = entry->next;
+            if(expired_at(hm, entry, now)){
+                //expired entries are reclaimed like get_data does, not shown to predicate
+                unlink_entry(hm, i, prev_entry, entry, hm->evict_data);
+            }else if(predicate(entry->key, entry_value(hm, entry), ctx)){
+                unlink_entry(hm, i, prev_entry, entry, destroy_data);
+                removed++;
+            }else{
+                prev_entry = entry;
+            }
+            entry = next_entry;
+        }
+    }
+    return removed;
+}
+
 unsigned int hash(char *key){
     unsigned int hash = 0;
     while (*key != '\0') {
@@ -197,6 +1045,16 @@ unsigned int hash(char *key){
     return hash;
 }
 
+unsigned int fnvHash(char *key){
+    unsigned int hash = 2166136261u;
+    while (*key != '\0') {
+        hash ^= (unsigned char) *key;
+        hash *= 16777619u;
+        key++;
+    }
+    return hash;
+}
+
 unsigned int hashPlusOne(char *key){
     return hash(key) + 1;
 }
@@ -210,21 +1068,20 @@ void set_hash_function(HashMap *hm, unsigned int (*hash_function)(char *key)){
         return;
     }
 
-    HashMap *new_hm = create_hashmap(hm->num_buckets);
-    new_hm->hash = hm->hash;
-    for(size_t i = 0; i < hm->num_buckets; i++){
-        Entry *entry = hm->entries[i];
-        if(entry->key != NULL){
-            while(entry != NULL){
-                insert_data(new_hm,entry->key,entry->value,overWriteCallback);
-                entry = entry->next;
-            }
-        }
+    rebuild_map(hm, hm->entry_size);
+}
+
+time_t monotonic_clock(void){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+void set_clock_function(HashMap *hm, time_t (*clock_function)(void)){
+    if(hm == NULL || clock_function == NULL){
+        return;
     }
-    Entry** old_entries = hm->entries;
-    hm->entries = new_hm->entries;
-    new_hm->entries = old_entries;
-    delete_hashmap(new_hm, NULL);
+    hm->clock = clock_function;
 }
 
 void* dontOverWriteCallback(void *old_data, void *new_data){
@@ -5,38 +5,124 @@
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 typedef struct Entry {
     char* key;              // key is NULL if this slot is empty
-    void* value;
     struct Entry* next;
+    void* value;            // not allocated in HashSet entries, see KeyEntry
 } Entry;
 
+// HashSet entries are only this prefix of Entry, the chain code never reads their value.
+typedef struct KeyEntry {
+    char* key;
+    struct Entry* next;
+} KeyEntry;
+
+typedef struct TrackedEntry {
+    Entry entry;
+    struct TrackedEntry* lru_prev;  // more recently used entry, only linked in cache mode
+    struct TrackedEntry* lru_next;  // less recently used entry, only linked in cache mode
+    time_t expires_at;              // expiry time, only meaningful if heap_index is set
+    size_t heap_index;              // position in the expiry heap plus one, 0 if the entry never expires
+} TrackedEntry;             // entry of a cache or of a map holding ttls
+
+typedef enum CacheUnit {
+    CACHE_ENTRIES,          // capacity is a number of entries
+    CACHE_BYTES             // capacity is the bytes taken by entries and key copies
+} CacheUnit;
+
+// Fields read by every lookup come first, fields that lookups and inserts write come after
+// read_mostly_padding so a write never invalidates the cache line other readers need.
 typedef struct HashMap{
     Entry** entries;                    // hash slots
     size_t num_buckets;                 // size of _entries array
-    size_t size;                        // number of items in hash table
     unsigned int (*hash)(char *key);    // hash function
+    size_t entry_size;                  // sizeof the KeyEntry, Entry or TrackedEntry this map allocates
+    size_t capacity;                    // cache capacity, 0 if not in cache mode
+    CacheUnit capacity_unit;            // unit of capacity and used
+    time_t (*clock)(void);              // clock function used for ttl expiry
+    uint64_t* filter;                   // bloom filter over inserted keys, NULL if disabled
+    size_t filter_bits;                 // number of bits in filter
+    void (*evict_data)(void *data);     // called on the value of evicted or expired entries
+    Entry* entry_arena;                 // block holding entries made by hashmap_build, NULL otherwise
+    size_t entry_arena_size;            // number of entries in entry_arena
+    char* key_arena;                    // block holding key copies made by hashmap_build
+    size_t key_arena_size;              // size of key_arena in bytes
+    char read_mostly_padding[64];
+    size_t size;                        // number of items in hash table
+    size_t hits;                        // get_data calls on a cache that found their key
+    size_t misses;                      // get_data calls on a cache that did not
+    size_t used;                        // cache usage in capacity_unit
+    TrackedEntry* lru_head;             // most recently used entry
+    TrackedEntry* lru_tail;             // least recently used entry, evicted first
+    TrackedEntry** expiry_heap;         // min-heap of entries with a ttl, ordered by expires_at
+    size_t expiry_count;                // number of entries in expiry_heap
+    size_t expiry_capacity;             // size of expiry_heap array
 } HashMap;
 
+typedef struct HashSet {
+    HashMap *map;                       // map allocating KeyEntry, its values are always NULL
+} HashSet;
+
 typedef void* (*ResolveCollisionCallback)(void *old_data, void *new_data);
 typedef void (*DestroyDataCallback)(void *data);
+typedef void (*ParallelCallback)(char *key, void *data, void *ctx);
+typedef bool (*RemovePredicate)(char *key, void *data, void *ctx);
 void* dontOverWriteCallback(void *old_data, void *new_data);
 void* overWriteCallback(void *old_data, void *new_data);
 void destroyDataCallback(void *data);
 HashMap *create_hashmap(size_t key_space);
+// Sizes the map to one bucket per key and hashes with hash_function, fnvHash if NULL.
+// Entries and key copies are laid out contiguously per bucket. Returns NULL if two keys are equal.
+HashMap *hashmap_build(char **keys, void **values, size_t n, unsigned int (*hash_function)(char *key), size_t nthreads);
+// Evicts least recently used entries once capacity entries (CACHE_ENTRIES) or bytes of
+// entries and key copies (CACHE_BYTES) are exceeded, passing their data to destroy_data.
+HashMap *create_cache(size_t key_space, size_t capacity, CacheUnit unit, DestroyDataCallback destroy_data);
 Entry *newEntry();
 
 void delete_hashmap(HashMap *hm, DestroyDataCallback destroy_data);
+void delete_hashmap_parallel(HashMap *hm, DestroyDataCallback destroy_data, size_t nthreads);
 void insert_data(HashMap *hm, char *key, void *data, ResolveCollisionCallback resolve_collision);
+// The entry expires ttl clock ticks from now, does nothing on the map of a HashSet. An expired key is reclaimed and inserted as new,
+// a plain insert_data that stores a new value drops the ttl. Expired entries are skipped by
+// get_data and the walkers but still counted in size until they are reclaimed.
+void insert_data_ttl(HashMap *hm, char *key, void *data, time_t ttl, ResolveCollisionCallback resolve_collision);
+// Reclaims at most budget expired entries, oldest first, and returns how many it reclaimed.
+size_t hashmap_expire_step(HashMap *hm, size_t budget);
+void set_evict_callback(HashMap *hm, DestroyDataCallback destroy_data);
 void *get_data(HashMap *hm, char *key);
+// get_data without side effects: counts nothing, leaves the LRU order alone and skips expired keys
+// without reclaiming them. Safe to call from hashmap_parallel_for callbacks.
+void *get_data_readonly(HashMap *hm, char *key);
 void remove_data(HashMap *hm, char *key, DestroyDataCallback destroy_data);
 
 void iterate(HashMap *hm, void (*callback)(char *key, void *data));
+// Runs callback on disjoint bucket ranges from nthreads new threads. The callback may read the map
+// with get_data_readonly or hashset_contains, but must not call get_data, insert or remove.
+void hashmap_parallel_for(HashMap *hm, size_t nthreads, ParallelCallback callback, void *ctx);
+size_t hashmap_remove_if(HashMap *hm, RemovePredicate predicate, void *ctx, DestroyDataCallback destroy_data);
+
+// Bloom filter sized for expected_keys, lookups of keys it rejects never touch a bucket.
+void hashmap_enable_filter(HashMap *hm, size_t expected_keys);
+
+HashSet *create_hashset(size_t key_space);
+void delete_hashset(HashSet *hs);
+void hashset_add(HashSet *hs, char *key);
+bool hashset_contains(HashSet *hs, char *key);
+void hashset_remove(HashSet *hs, char *key);
+void hashset_enable_filter(HashSet *hs, size_t expected_keys);
 
 unsigned int hash(char *key);
 unsigned int hashPlusOne(char *key);
+unsigned int fnvHash(char *key);
 void set_hash_function(HashMap *hm, unsigned int (*hash_function)(char *key));
 
+// Default ttl clock, in seconds.
+time_t monotonic_clock(void);
+void set_clock_function(HashMap *hm, time_t (*clock_function)(void));
+
 
 
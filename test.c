@@ -87,10 +87,11 @@ void insertGetTest() {
     assert_str_equals(get_data(hm, "a"), "b");
 
     insert_data(hm, "a", "c", overWriteCallback);
-    assert_str_equals(get_data(hm, "a"), "b");
+    assert_str_equals(get_data(hm, "a"), "c");
+    assert_int_equals(hm->size, 1);
     insert_data(hm, "b", "a", overWriteCallback);
     assert_str_equals(get_data(hm, "b"), "a");
-    assert_str_equals(get_data(hm, "a"), "b");
+    assert_str_equals(get_data(hm, "a"), "c");
     delete_hashmap(hm, NULL);
 }
 
@@ -286,6 +287,394 @@ void rehashTest(){
     delete_hashmap(hm, NULL);
 }
 
+void countingDestroyCallback(void *data){
+    global_iterator_counter++;
+}
+
+void cacheEvictionTest(){
+    HashMap *hm = create_cache(100, 2, CACHE_ENTRIES, countingDestroyCallback);
+    global_iterator_counter = 0;
+    insert_data(hm, "a", "1", overWriteCallback);
+    insert_data(hm, "b", "2", overWriteCallback);
+    assert_str_equals(get_data(hm, "a"), "1");
+    insert_data(hm, "c", "3", overWriteCallback);
+
+    assert_int_equals(hm->size, 2);
+    assert_int_equals(global_iterator_counter, 1);
+    assert_ptr_equals(get_data(hm, "b"), NULL);
+    assert_str_equals(get_data(hm, "a"), "1");
+    assert_str_equals(get_data(hm, "c"), "3");
+    assert_int_equals(hm->hits, 3);
+    assert_int_equals(hm->misses, 1);
+
+    set_hash_function(hm, hashPlusOne);
+    insert_data(hm, "d", "4", overWriteCallback);
+    assert_ptr_equals(get_data(hm, "a"), NULL);
+    assert_str_equals(get_data(hm, "c"), "3");
+    assert_str_equals(get_data(hm, "d"), "4");
+
+    remove_data(hm, "c", NULL);
+    assert_int_equals(hm->used, 1);
+    delete_hashmap(hm, NULL);
+    assert_ptr_equals(create_cache(100, 0, CACHE_ENTRIES, NULL), NULL);
+}
+
+void cacheUpdateTest(){
+    HashMap *hm = create_cache(1, 2, CACHE_ENTRIES, countingDestroyCallback);
+    global_iterator_counter = 0;
+    insert_data(hm, "a", "1", overWriteCallback);
+    insert_data(hm, "b", "2", overWriteCallback);
+    insert_data(hm, "b", "3", overWriteCallback);
+
+    assert_int_equals(hm->size, 2);
+    assert_int_equals(hm->used, 2);
+    assert_int_equals(global_iterator_counter, 0);
+    assert_str_equals(get_data(hm, "a"), "1");
+    assert_str_equals(get_data(hm, "b"), "3");
+    delete_hashmap(hm, NULL);
+}
+
+void cacheBytesTest(){
+    size_t key_count = 1000;
+    size_t capacity = 10 * (sizeof(TrackedEntry) + 4);
+    HashMap *hm = create_cache(10, capacity, CACHE_BYTES, destroyDataCallback);
+    for (size_t i = 0; i < key_count; ++i) {
+        char key[4];
+        sprintf(key, "%03zu", i);
+        char *value = malloc(sizeof(key));
+        strcpy(value, key);
+        insert_data(hm, key, value, overWriteCallback);
+        assert_true(hm->used <= capacity);
+    }
+    assert_int_equals(hm->size, 10);
+    assert_str_equals(get_data(hm, "999"), "999");
+    assert_ptr_equals(get_data(hm, "989"), NULL);
+    delete_hashmap(hm, destroyDataCallback);
+}
+
+time_t fake_time = 0;
+
+time_t fakeClock(void){
+    return fake_time;
+}
+
+void ttlExpiryTest(){
+    HashMap *hm = create_hashmap(100);
+    set_clock_function(hm, fakeClock);
+    set_evict_callback(hm, countingDestroyCallback);
+    global_iterator_counter = 0;
+    fake_time = 0;
+
+    insert_data_ttl(hm, "a", "1", 10, overWriteCallback);
+    insert_data_ttl(hm, "b", "2", 5, overWriteCallback);
+    insert_data_ttl(hm, "c", "3", 20, overWriteCallback);
+    insert_data(hm, "d", "4", overWriteCallback);
+    assert_int_equals(hm->expiry_count, 3);
+
+    fake_time = 5;
+    assert_ptr_equals(get_data(hm, "b"), NULL);
+    assert_int_equals(global_iterator_counter, 1);
+    assert_str_equals(get_data(hm, "a"), "1");
+
+    insert_data_ttl(hm, "a", "1", 30, dontOverWriteCallback);
+    set_hash_function(hm, hashPlusOne);
+    fake_time = 25;
+    assert_int_equals(hashmap_expire_step(hm, 10), 1);
+    assert_ptr_equals(get_data(hm, "c"), NULL);
+    assert_str_equals(get_data(hm, "a"), "1");
+
+    fake_time = 100;
+    assert_int_equals(hashmap_expire_step(hm, 0), 0);
+    assert_int_equals(hashmap_expire_step(hm, 10), 1);
+    assert_int_equals(global_iterator_counter, 3);
+    assert_int_equals(hm->size, 1);
+    assert_int_equals(hm->expiry_count, 0);
+    assert_str_equals(get_data(hm, "d"), "4");
+    delete_hashmap(hm, NULL);
+}
+
+void ttlRefreshTest(){
+    HashMap *hm = create_cache(100, 10, CACHE_ENTRIES, countingDestroyCallback);
+    set_clock_function(hm, fakeClock);
+    global_iterator_counter = 0;
+    fake_time = 0;
+
+    insert_data_ttl(hm, "s", "stale", 1, dontOverWriteCallback);
+    fake_time = 5;
+    insert_data_ttl(hm, "s", "fresh", 10, dontOverWriteCallback);
+    assert_int_equals(global_iterator_counter, 1);
+    assert_int_equals(hm->size, 1);
+    assert_int_equals(hm->used, 1);
+    assert_str_equals(get_data(hm, "s"), "fresh");
+
+    insert_data(hm, "s", "kept", dontOverWriteCallback);
+    assert_int_equals(hm->expiry_count, 1);
+    insert_data(hm, "s", "plain", overWriteCallback);
+    assert_int_equals(hm->expiry_count, 0);
+    fake_time = 100;
+    assert_str_equals(get_data(hm, "s"), "plain");
+
+    insert_data_ttl(hm, "t", "old", 5, overWriteCallback);
+    insert_data(hm, "t", "new", dontOverWriteCallback);
+    fake_time = 200;
+    assert_ptr_equals(get_data(hm, "t"), NULL);
+    delete_hashmap(hm, NULL);
+}
+
+bool alwaysPredicate(char *key, void *data, void *ctx){
+    return true;
+}
+
+void ttlWalkTest(){
+    HashMap *hm = create_hashmap(10);
+    set_clock_function(hm, fakeClock);
+    set_evict_callback(hm, countingDestroyCallback);
+    fake_time = 0;
+    insert_data_ttl(hm, "a", "1", 5, overWriteCallback);
+    insert_data_ttl(hm, "b", "2", 50, overWriteCallback);
+    insert_data(hm, "c", "3", overWriteCallback);
+    fake_time = 10;
+
+    global_iterator_counter = 0;
+    iterate(hm, silentCallback);
+    assert_int_equals(global_iterator_counter, '2' + '3');
+
+    global_iterator_counter = 0;
+    assert_int_equals(hashmap_remove_if(hm, alwaysPredicate, NULL, NULL), 2);
+    assert_int_equals(global_iterator_counter, 1);
+    assert_int_equals(hm->size, 0);
+    delete_hashmap(hm, NULL);
+}
+
+void ttlManyKeysTest(){
+    int key_count = 1000;
+    HashMap *hm = create_hashmap(10);
+    set_clock_function(hm, fakeClock);
+    fake_time = 0;
+    for (int i = 0; i < key_count; ++i) {
+        char key[8];
+        sprintf(key, "%d", i);
+        insert_data_ttl(hm, key, NULL, key_count - i, overWriteCallback);
+    }
+    fake_time = key_count / 2;
+    assert_int_equals(hashmap_expire_step(hm, key_count), key_count / 2);
+    assert_int_equals(hm->size, key_count / 2);
+    remove_data(hm, "0", NULL);
+    assert_int_equals(hm->expiry_count, key_count / 2 - 1);
+    delete_hashmap(hm, NULL);
+}
+
+void buildTest(){
+    size_t key_count = 1000;
+    char** keys = malloc(sizeof(char*) * key_count);
+    for (size_t i = 0; i < key_count; ++i) {
+        int maxIntLength = snprintf(NULL, 0, "%zu", i)+1;
+        keys[i] = malloc(sizeof(char) * maxIntLength);
+        sprintf(keys[i], "%zu", i);
+    }
+    for (size_t nthreads = 1; nthreads <= 4; nthreads += 3) {
+        HashMap *hm = hashmap_build(keys, (void **) keys, key_count, NULL, nthreads);
+        assert_int_equals(hm->num_buckets, key_count);
+        assert_int_equals(hm->size, key_count);
+        for (size_t i = 0; i < key_count; ++i) {
+            assert_str_equals(get_data(hm, keys[i]), keys[i]);
+        }
+        assert_ptr_equals(get_data(hm, "missing"), NULL);
+
+        remove_data(hm, keys[0], NULL);
+        remove_data(hm, keys[500], NULL);
+        insert_data(hm, "new", "value", overWriteCallback);
+        assert_int_equals(hm->size, key_count - 1);
+        assert_str_equals(get_data(hm, "new"), "value");
+        if (nthreads > 1) {
+            set_hash_function(hm, hashPlusOne);
+            assert_str_equals(get_data(hm, keys[999]), keys[999]);
+        }
+        delete_hashmap(hm, NULL);
+    }
+    assert_ptr_equals(hashmap_build(keys, NULL, 0, NULL, 1), NULL);
+    HashMap *hm = hashmap_build(keys, NULL, 10, NULL, 2);
+    assert_ptr_equals(get_data(hm, "9"), NULL);
+    // plain maps do not count lookups
+    assert_int_equals(hm->hits, 0);
+    delete_hashmap(hm, NULL);
+
+    hm = hashmap_build(keys, (void **) keys, key_count, NULL, 4);
+    assert_true(hm->hash == fnvHash);
+    size_t longest_chain = 0;
+    for (size_t i = 0; i < hm->num_buckets; ++i) {
+        size_t chain = 0;
+        for (Entry *entry = hm->entries[i]; entry != NULL && entry->key != NULL; entry = entry->next) {
+            chain++;
+        }
+        longest_chain = chain > longest_chain ? chain : longest_chain;
+    }
+    assert_true(longest_chain < 10);
+    assert_str_equals(get_data(hm, keys[123]), keys[123]);
+    delete_hashmap(hm, NULL);
+
+    char *duplicated[] = {"x", "x", "y"};
+    assert_ptr_equals(hashmap_build(duplicated, NULL, 3, NULL, 1), NULL);
+    assert_ptr_equals(hashmap_build(duplicated, NULL, 3, hash, 2), NULL);
+    hm = hashmap_build(keys, NULL, key_count, hash, 2);
+    assert_true(hm->hash == hash);
+    assert_ptr_equals(get_data(hm, "missing"), NULL);
+    delete_hashmap(hm, NULL);
+    for (size_t i = 0; i < key_count; ++i) {
+        free(keys[i]);
+    }
+    free(keys);
+}
+
+void hashSetTest(){
+    HashSet *hs = create_hashset(10);
+    hashset_add(hs, "a");
+    hashset_add(hs, "a");
+    hashset_add(hs, "k");
+    assert_int_equals(hs->map->size, 2);
+    assert_true(hashset_contains(hs, "a"));
+    assert_true(hashset_contains(hs, "k"));
+    assert_false(hashset_contains(hs, "b"));
+
+    hashset_remove(hs, "u");
+    assert_int_equals(hs->map->size, 2);
+    hashset_remove(hs, "a");
+    assert_false(hashset_contains(hs, "a"));
+    assert_true(hashset_contains(hs, "k"));
+    delete_hashset(hs);
+}
+
+unsigned int countingHash(char *key){
+    global_iterator_counter++;
+    return hash(key);
+}
+
+void entrySizeTest(){
+    HashSet *hs = create_hashset(10);
+    HashMap *hm = create_hashmap(10);
+    HashMap *cache = create_cache(10, 10, CACHE_ENTRIES, NULL);
+    assert_int_equals(hs->map->entry_size, 2 * sizeof(void *));
+    assert_int_equals(hm->entry_size, 3 * sizeof(void *));
+    assert_int_equals(sizeof(Entry), 3 * sizeof(void *));
+    assert_int_equals(cache->entry_size, sizeof(TrackedEntry));
+
+    hashset_add(hs, "a");
+    assert_true(hashset_contains(hs, "a"));
+    insert_data_ttl(hs->map, "b", NULL, 10, overWriteCallback);
+    assert_int_equals(hs->map->entry_size, sizeof(KeyEntry));
+    assert_false(hashset_contains(hs, "b"));
+    insert_data(hm, "a", "1", overWriteCallback);
+    insert_data_ttl(hm, "b", "2", 10, overWriteCallback);
+    assert_int_equals(hm->entry_size, sizeof(TrackedEntry));
+    assert_str_equals(get_data(hm, "a"), "1");
+    assert_str_equals(get_data(hm, "b"), "2");
+
+    delete_hashset(hs);
+    delete_hashmap(hm, NULL);
+    delete_hashmap(cache, NULL);
+}
+
+void filterTest(){
+    int key_count = 1000;
+    HashMap *hm = create_hashmap(100);
+    insert_data(hm, "before", "1", overWriteCallback);
+    hashmap_enable_filter(hm, key_count);
+    assert_str_equals(get_data(hm, "before"), "1");
+
+    char key[16];
+    for (int i = 0; i < key_count; ++i) {
+        sprintf(key, "%d", i);
+        insert_data(hm, key, "x", overWriteCallback);
+    }
+    set_hash_function(hm, countingHash);
+    for (int i = 0; i < key_count; ++i) {
+        sprintf(key, "%d", i);
+        assert_str_equals(get_data(hm, key), "x");
+    }
+    global_iterator_counter = 0;
+    for (int i = key_count; i < 2 * key_count; ++i) {
+        sprintf(key, "%d", i);
+        assert_ptr_equals(get_data(hm, key), NULL);
+    }
+    // only false positives of the filter reach the buckets
+    assert_true(global_iterator_counter < key_count / 20);
+    delete_hashmap(hm, NULL);
+}
+
+typedef struct SumContext {
+    pthread_mutex_t lock;
+    int sum;
+} SumContext;
+
+void sumCallback(char *key, void *data, void *ctx){
+    SumContext *sum = ctx;
+    pthread_mutex_lock(&sum->lock);
+    sum->sum += atoi(data);
+    pthread_mutex_unlock(&sum->lock);
+}
+
+typedef struct LookupContext {
+    HashMap *hm;
+    atomic_int found;
+} LookupContext;
+
+void lookupCallback(char *key, void *data, void *ctx){
+    LookupContext *lookup = ctx;
+    if (get_data_readonly(lookup->hm, key) == data) {
+        atomic_fetch_add(&lookup->found, 1);
+    }
+}
+
+bool isEvenPredicate(char *key, void *data, void *ctx){
+    return atoi(data) % 2 == 0;
+}
+
+void parallelTest(){
+    int key_count = 1000;
+    HashMap *hm = create_hashmap(10);
+    for (int i = 0; i < key_count; ++i) {
+        char key[8];
+        sprintf(key, "%d", i);
+        char *value = malloc(sizeof(key));
+        strcpy(value, key);
+        insert_data(hm, key, value, overWriteCallback);
+    }
+    SumContext sum = { .sum = 0 };
+    pthread_mutex_init(&sum.lock, NULL);
+    hashmap_parallel_for(hm, 4, sumCallback, &sum);
+    assert_int_equals(sum.sum, key_count * (key_count - 1) / 2);
+
+    assert_int_equals(hashmap_remove_if(hm, isEvenPredicate, NULL, destroyDataCallback), key_count / 2);
+    assert_int_equals(hm->size, key_count / 2);
+    assert_ptr_equals(get_data(hm, "2"), NULL);
+    assert_str_equals(get_data(hm, "3"), "3");
+
+    sum.sum = 0;
+    hashmap_parallel_for(hm, 64, sumCallback, &sum);
+    assert_int_equals(sum.sum, key_count * key_count / 4);
+    pthread_mutex_destroy(&sum.lock);
+    delete_hashmap_parallel(hm, destroyDataCallback, 4);
+
+    HashMap *cache = create_cache(10, key_count, CACHE_ENTRIES, NULL);
+    set_clock_function(cache, fakeClock);
+    fake_time = 0;
+    for (int i = 0; i < key_count; ++i) {
+        char key[8];
+        sprintf(key, "%d", i);
+        insert_data_ttl(cache, key, "v", i % 2 == 0 ? 1 : 100, overWriteCallback);
+    }
+    fake_time = 50;
+    size_t hits = cache->hits;
+    TrackedEntry *head = cache->lru_head;
+    LookupContext lookup = { .hm = cache, .found = 0 };
+    hashmap_parallel_for(cache, 4, lookupCallback, &lookup);
+    assert_int_equals(lookup.found, key_count / 2);
+    assert_int_equals(cache->hits, hits);
+    assert_int_equals(cache->size, key_count);
+    assert_ptr_equals(cache->lru_head, head);
+    delete_hashmap(cache, NULL);
+}
+
 
 /* Register all test cases. */
 void register_tests() {
@@ -303,6 +692,18 @@ void register_tests() {
     register_test(countTest);
     register_test(checkDuplicatedKey);
     register_test(rehashTest);
+    register_test(cacheEvictionTest);
+    register_test(cacheUpdateTest);
+    register_test(cacheBytesTest);
+    register_test(ttlExpiryTest);
+    register_test(ttlRefreshTest);
+    register_test(ttlWalkTest);
+    register_test(ttlManyKeysTest);
+    register_test(buildTest);
+    register_test(hashSetTest);
+    register_test(entrySizeTest);
+    register_test(filterTest);
+    register_test(parallelTest);
 }
 
 